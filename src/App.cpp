@@ -1,11 +1,11 @@
 #include "App.h"
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 
 #include <glad/gl.h>
 
-#include <fstream>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "GLDebugCallback.h"
@@ -16,52 +16,21 @@ namespace
 constexpr auto WINDOW_WIDTH = 1280;
 constexpr auto WINDOW_HEIGHT = 960;
 
+constexpr auto TARGET_FRAME_TIME = 1.f / 60.f;
+constexpr auto MIN_RESOLUTION_SCALE = 0.5f;
+constexpr auto MAX_RESOLUTION_SCALE = 1.f;
+
 constexpr auto VP_UNIFORM_LOC = 0;
 constexpr auto MODEL_UNIFORM_LOC = 1;
 constexpr auto FRAG_TEXTURE_UNIFORM_LOC = 2;
 
-void setDebugLabel(GLenum identifier, GLuint name, std::string_view label)
-{
-    glObjectLabel(identifier, name, label.size(), label.data());
-}
+constexpr auto SPATIAL_GRID_CELL_SIZE = 1.f;
 
-std::string readFileToString(const std::filesystem::path& path)
-{
-    // open file
-    std::ifstream f(path);
-    if (!f.good()) {
-        std::cerr << "Failed to open shader file from " << path << std::endl;
-        return {};
-    }
-    // read whole file into string buffer
-    std::stringstream buffer;
-    buffer << f.rdbuf();
-    return buffer.str();
-}
+const auto CUBE_AABB = AABB{glm::vec3{-0.5f}, glm::vec3{0.5f}};
 
-GLuint compileShader(const std::filesystem::path& path, GLenum shaderType)
+void setDebugLabel(GLenum identifier, GLuint name, std::string_view label)
 {
-    GLint shader = glCreateShader(shaderType);
-
-    const auto sourceStr = readFileToString(path);
-    const char* sourceCStr = sourceStr.c_str();
-    glShaderSource(shader, 1, &sourceCStr, NULL);
-
-    glCompileShader(shader);
-
-    // check for shader compile errors
-    int success{};
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        GLint logLength{};
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-        std::string log(logLength + 1, '\0');
-        glGetShaderInfoLog(shader, logLength, NULL, &log[0]);
-        std::cout << "Failed to compile shader:" << log << std::endl;
-        return 0;
-    }
-    setDebugLabel(GL_SHADER, shader, path.string());
-    return shader;
+    glObjectLabel(identifier, name, label.size(), label.data());
 }
 
 // will add ability to pass params later
@@ -148,39 +117,13 @@ void App::init()
     gl::enableDebugCallback();
     glEnable(GL_FRAMEBUFFER_SRGB);
 
-    { // shaders
-        const auto vertexShader = compileShader("assets/shaders/basic.vert", GL_VERTEX_SHADER);
-        if (vertexShader == 0) {
-            std::exit(1);
-        }
-
-        const auto fragShader = compileShader("assets/shaders/basic.frag", GL_FRAGMENT_SHADER);
-        if (fragShader == 0) {
-            std::exit(1);
-        }
-
-        shaderProgram = glCreateProgram();
-        setDebugLabel(GL_PROGRAM, shaderProgram, "shader");
-
-        // link
-        glAttachShader(shaderProgram, vertexShader);
-        glAttachShader(shaderProgram, fragShader);
-        glLinkProgram(shaderProgram);
-
-        // check for linking errors
-        int success{};
-        glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-        if (!success) {
-            GLint logLength;
-            glGetShaderiv(shaderProgram, GL_INFO_LOG_LENGTH, &logLength);
-            std::string log(logLength + 1, '\0');
-            glGetProgramInfoLog(shaderProgram, logLength, NULL, &log[0]);
-            std::cout << "Shader linking failed: " << log << std::endl;
-            std::exit(1);
-        }
-
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragShader);
+    ShaderPermutations::initParallelCompile();
+    if (!basicShader.init(
+            "assets/shaders/basic.vert",
+            "assets/shaders/basic.frag",
+            {}, // no features yet
+            "basic shader")) {
+        std::exit(1);
     }
 
     // we still need an empty VAO even for vertex pulling
@@ -250,6 +193,14 @@ void App::init()
         std::exit(1);
     }
 
+    { // scene render target
+        int drawableWidth{}, drawableHeight{};
+        SDL_GL_GetDrawableSize(window, &drawableWidth, &drawableHeight);
+        createSceneRenderTarget(drawableWidth, drawableHeight);
+    }
+    gpuTimer.init();
+    dynamicResolution.init(TARGET_FRAME_TIME, MIN_RESOLUTION_SCALE, MAX_RESOLUTION_SCALE);
+
     // initial state
     glEnable(GL_DEPTH_TEST);
 
@@ -261,14 +212,59 @@ void App::init()
         camera.setPosition(glm::vec3{0.f, 1.f, -3.f});
         camera.lookAt(glm::vec3{0.f, 0.f, 0.f});
     }
+
+    spatialGrid.init(SPATIAL_GRID_CELL_SIZE);
+    cubeObjectId = spatialGrid.insert(util::transformAABB(CUBE_AABB, cubeTransform.asMatrix()));
+}
+
+void App::createSceneRenderTarget(int width, int height)
+{
+    // textures are allocated at max resolution, lower resolutions only use a part of them
+    destroySceneRenderTarget();
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &sceneColorTexture);
+    setDebugLabel(GL_TEXTURE, sceneColorTexture, "scene color");
+    glTextureStorage2D(sceneColorTexture, 1, GL_SRGB8_ALPHA8, width, height);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &sceneDepthTexture);
+    setDebugLabel(GL_TEXTURE, sceneDepthTexture, "scene depth");
+    glTextureStorage2D(sceneDepthTexture, 1, GL_DEPTH_COMPONENT32F, width, height);
+
+    glCreateFramebuffers(1, &sceneFramebuffer);
+    setDebugLabel(GL_FRAMEBUFFER, sceneFramebuffer, "scene");
+    glNamedFramebufferTexture(sceneFramebuffer, GL_COLOR_ATTACHMENT0, sceneColorTexture, 0);
+    glNamedFramebufferTexture(sceneFramebuffer, GL_DEPTH_ATTACHMENT, sceneDepthTexture, 0);
+
+    const auto status = glCheckNamedFramebufferStatus(sceneFramebuffer, GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Scene framebuffer is incomplete, status: " << status << std::endl;
+        std::exit(1);
+    }
+
+    sceneTargetWidth = width;
+    sceneTargetHeight = height;
+}
+
+void App::destroySceneRenderTarget()
+{
+    // deleting 0 is a no-op, so this is fine to call before the target was created
+    glDeleteFramebuffers(1, &sceneFramebuffer);
+    glDeleteTextures(1, &sceneColorTexture);
+    glDeleteTextures(1, &sceneDepthTexture);
+    sceneFramebuffer = 0;
+    sceneColorTexture = 0;
+    sceneDepthTexture = 0;
 }
 
 void App::cleanup()
 {
+    gpuTimer.cleanup();
+    destroySceneRenderTarget();
+
     glDeleteBuffers(1, &verticesBuffer);
     glDeleteTextures(1, &texture);
     glDeleteVertexArrays(1, &vao);
-    glDeleteProgram(shaderProgram);
+    basicShader.cleanup();
 
     SDL_GL_DeleteContext(glContext);
     SDL_DestroyWindow(window);
@@ -311,6 +307,14 @@ void App::run()
                     isRunning = false;
                     return;
                 }
+                if (event.type == SDL_WINDOWEVENT &&
+                    event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                    int drawableWidth{}, drawableHeight{};
+                    SDL_GL_GetDrawableSize(window, &drawableWidth, &drawableHeight);
+                    if (drawableWidth > 0 && drawableHeight > 0) { // 0 when minimized
+                        createSceneRenderTarget(drawableWidth, drawableHeight);
+                    }
+                }
             }
 
             update(dt);
@@ -335,16 +339,41 @@ void App::update(float dt)
     // rotate cube
     static const auto rotationSpeed = glm::radians(45.f);
     cubeTransform.heading *= glm::angleAxis(rotationSpeed * dt, glm::vec3{0.f, 1.f, 0.f});
+    spatialGrid.update(cubeObjectId, util::transformAABB(CUBE_AABB, cubeTransform.asMatrix()));
 }
 
 void App::render()
 {
+    basicShader.update();
+    if (basicShader.getState(0) == ShaderPermutations::State::Failed) {
+        std::exit(1);
+    }
+
+    // measurements come back a few frames late, feed all of them to the controller
+    while (const auto gpuFrameTime = gpuTimer.poll()) {
+        dynamicResolution.update(*gpuFrameTime);
+    }
+
+    const auto scale = dynamicResolution.getScale();
+    const auto renderWidth = std::max(1, static_cast<int>(sceneTargetWidth * scale));
+    const auto renderHeight = std::max(1, static_cast<int>(sceneTargetHeight * scale));
+
+    gpuTimer.begin();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glViewport(0, 0, renderWidth, renderHeight);
+
+    // don't clear the parts of the render target which are not used at current scale
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, renderWidth, renderHeight);
+
     glClearColor(97.f / 255.f, 120.f / 255.f, 159.f / 255.f, 1.0f);
     glClearDepth(1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     glBindVertexArray(vao);
-    {
+    // draws nothing until the shader is compiled
+    if (const auto shaderProgram = basicShader.getProgram(0); shaderProgram != 0) {
         // vertices
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, verticesBuffer);
 
@@ -366,5 +395,32 @@ void App::render()
         glDrawArrays(GL_TRIANGLES, 0, 36);
     }
 
+    { // upscale to window
+        // blits are affected by the scissor test
+        glDisable(GL_SCISSOR_TEST);
+
+        int windowWidth{}, windowHeight{};
+        SDL_GL_GetDrawableSize(window, &windowWidth, &windowHeight);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBlitNamedFramebuffer(
+            sceneFramebuffer,
+            0,
+            // src
+            0,
+            0,
+            renderWidth,
+            renderHeight,
+            // dst
+            0,
+            0,
+            windowWidth,
+            windowHeight,
+            GL_COLOR_BUFFER_BIT,
+            GL_LINEAR);
+    }
+
+    gpuTimer.end();
+
     SDL_GL_SwapWindow(window);
 }
@@ -5,6 +5,10 @@
 #include <SDL2/SDL.h>
 
 #include "Camera.h"
+#include "DynamicResolution.h"
+#include "GPUTimer.h"
+#include "ShaderPermutations.h"
+#include "SpatialHashGrid.h"
 
 struct Transform {
     glm::vec3 position{};
@@ -34,6 +38,9 @@ private:
     void update(float dt);
     void render();
 
+    void createSceneRenderTarget(int width, int height);
+    void destroySceneRenderTarget();
+
     SDL_Window* window{nullptr};
     SDL_GLContext glContext{nullptr};
 
@@ -42,13 +49,27 @@ private:
     float frameTime{0.f};
     float avgFPS{0.f};
 
-    std::uint32_t shaderProgram{};
+    ShaderPermutations basicShader;
     std::uint32_t vao{}; // empty vao
     std::uint32_t texture{};
 
     std::uint32_t verticesBuffer{};
 
+    // the scene is rendered into an offscreen target at dynamic
+    // resolution and then upscaled to the window
+    std::uint32_t sceneFramebuffer{};
+    std::uint32_t sceneColorTexture{};
+    std::uint32_t sceneDepthTexture{};
+    int sceneTargetWidth{0};
+    int sceneTargetHeight{0};
+
+    GPUTimer gpuTimer;
+    DynamicResolution dynamicResolution;
+
     Transform cubeTransform;
+    SpatialHashGrid::ObjectId cubeObjectId{SpatialHashGrid::NULL_OBJECT};
+
+    SpatialHashGrid spatialGrid;
 
     Camera camera;
 };
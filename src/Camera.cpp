@@ -42,3 +42,19 @@ glm::mat4 Camera::getViewProj() const
 {
     return projection * getView();
 }
+
+Ray Camera::getRayThroughPixel(const glm::vec2& pixel, const glm::vec2& screenSize) const
+{
+    const auto ndc = glm::vec2{
+        2.f * pixel.x / screenSize.x - 1.f,
+        1.f - 2.f * pixel.y / screenSize.y,
+    };
+
+    const auto invVP = glm::inverse(getViewProj());
+    const auto nearPoint = invVP * glm::vec4{ndc, -1.f, 1.f};
+    const auto farPoint = invVP * glm::vec4{ndc, 1.f, 1.f};
+
+    const auto from = glm::vec3{nearPoint} / nearPoint.w;
+    const auto to = glm::vec3{farPoint} / farPoint.w;
+    return Ray{.origin = from, .dir = glm::normalize(to - from)};
+}
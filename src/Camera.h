@@ -2,8 +2,11 @@
 
 #include <glm/gtc/quaternion.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 
+#include "Geometry.h"
+
 class Camera {
 public:
     void init(float fovX, float zNear, float zFar, float aspectRatio);
@@ -19,6 +22,9 @@ public:
 
     void lookAt(const glm::vec3& point);
 
+    // ray from the camera through the pixel (origin is top-left corner of the screen)
+    Ray getRayThroughPixel(const glm::vec2& pixel, const glm::vec2& screenSize) const;
+
 private:
     glm::vec3 position;
     glm::quat heading;
@@ -0,0 +1,66 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// part of the frame budget which the GPU is allowed to spend,
+// the rest is left for the CPU side, swap and measurement noise
+constexpr auto BUDGET_FRACTION = 0.9f;
+// only go up in resolution when we're well below the budget,
+// otherwise the scale would keep bouncing around the threshold
+constexpr auto UPSCALE_THRESHOLD = 0.75f;
+
+constexpr auto SMOOTHING_FACTOR = 0.1f;
+constexpr auto MAX_SCALE_STEP = 0.1f;
+constexpr auto COOLDOWN_FRAMES = 8;
+}
+
+void DynamicResolution::init(float targetFrameTime, float minScale, float maxScale)
+{
+    this->targetFrameTime = targetFrameTime;
+    this->minScale = minScale;
+    this->maxScale = maxScale;
+
+    scale = maxScale;
+    smoothedFrameTime = targetFrameTime * BUDGET_FRACTION;
+    cooldown = 0;
+}
+
+void DynamicResolution::update(float gpuFrameTime)
+{
+    // moving average
+    smoothedFrameTime = std::lerp(smoothedFrameTime, gpuFrameTime, SMOOTHING_FACTOR);
+
+    if (cooldown > 0) {
+        --cooldown;
+        return;
+    }
+
+    const auto budget = targetFrameTime * BUDGET_FRACTION;
+    const bool overBudget = smoothedFrameTime > budget;
+    const bool wellUnderBudget = smoothedFrameTime < budget * UPSCALE_THRESHOLD;
+    if (!overBudget && !wellUnderBudget) {
+        return;
+    }
+
+    // aim at the middle of the dead band, so that noise doesn't push us right back out of it
+    const auto targetTime = budget * (1.f + UPSCALE_THRESHOLD) / 2.f;
+    // GPU time is roughly proportional to the pixel count, which is proportional to scale^2
+    const auto desiredScale = scale * std::sqrt(targetTime / smoothedFrameTime);
+    const auto newScale = std::clamp(
+        std::clamp(desiredScale, scale - MAX_SCALE_STEP, scale + MAX_SCALE_STEP),
+        minScale,
+        maxScale);
+    if (newScale == scale) {
+        return;
+    }
+
+    // predict the frame time at the new scale instead of averaging with the old resolution
+    const auto ratio = newScale / scale;
+    smoothedFrameTime *= ratio * ratio;
+
+    scale = newScale;
+    cooldown = COOLDOWN_FRAMES;
+}
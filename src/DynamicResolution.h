@@ -0,0 +1,27 @@
+#pragma once
+
+// Picks the internal render resolution scale from measured GPU frame times.
+// The scale is applied to both dimensions, so the number of shaded pixels
+// changes by scale^2.
+class DynamicResolution {
+public:
+    void init(float targetFrameTime, float minScale, float maxScale);
+
+    // should be called every time a new GPU frame time measurement (in seconds) arrives
+    void update(float gpuFrameTime);
+
+    float getScale() const { return scale; }
+    float getSmoothedFrameTime() const { return smoothedFrameTime; }
+
+private:
+    float targetFrameTime{1.f / 60.f};
+    float minScale{0.5f};
+    float maxScale{1.f};
+
+    float scale{1.f};
+    float smoothedFrameTime{0.f};
+
+    // wait a bit after each change so that the queries issued with
+    // the new resolution have time to come back
+    int cooldown{0};
+};
@@ -0,0 +1,53 @@
+#include "GPUTimer.h"
+
+#include <glad/gl.h>
+
+void GPUTimer::init()
+{
+    glCreateQueries(GL_TIME_ELAPSED, NUM_QUERIES, queries.data());
+}
+
+void GPUTimer::cleanup()
+{
+    glDeleteQueries(NUM_QUERIES, queries.data());
+}
+
+void GPUTimer::begin()
+{
+    if (numPending == NUM_QUERIES) {
+        // all queries are in flight - drop the oldest result instead of waiting for it
+        readIndex = (readIndex + 1) % NUM_QUERIES;
+        --numPending;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, queries[writeIndex]);
+}
+
+void GPUTimer::end()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    writeIndex = (writeIndex + 1) % NUM_QUERIES;
+    ++numPending;
+}
+
+std::optional<float> GPUTimer::poll()
+{
+    if (numPending == 0) {
+        return std::nullopt;
+    }
+
+    const auto query = queries[readIndex];
+
+    GLint available{};
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        return std::nullopt;
+    }
+
+    GLuint64 elapsedNs{};
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsedNs);
+
+    readIndex = (readIndex + 1) % NUM_QUERIES;
+    --numPending;
+
+    return static_cast<float>(elapsedNs) / 1e9f;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+// Measures GPU time of a section of commands with GL_TIME_ELAPSED queries.
+// Several queries are kept in flight so that reading the result never stalls
+// the pipeline: the result of a frame becomes available a few frames later.
+class GPUTimer {
+public:
+    void init();
+    void cleanup();
+
+    void begin();
+    void end();
+
+    // returns time in seconds of the oldest finished measurement (if any)
+    std::optional<float> poll();
+
+private:
+    static constexpr std::size_t NUM_QUERIES = 4;
+
+    std::array<std::uint32_t, NUM_QUERIES> queries{};
+    std::size_t writeIndex{0}; // query which will be used by next begin()
+    std::size_t readIndex{0}; // oldest query which result wasn't read yet
+    std::size_t numPending{0};
+};
@@ -0,0 +1,71 @@
+#include "Geometry.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+namespace util
+{
+bool overlaps(const AABB& a, const AABB& b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+           a.min.y <= b.max.y && a.max.y >= b.min.y &&
+           a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+float distanceSquared(const AABB& aabb, const glm::vec3& point)
+{
+    const auto closest = glm::clamp(point, aabb.min, aabb.max);
+    const auto d = point - closest;
+    return glm::dot(d, d);
+}
+
+bool intersect(const Ray& ray, const AABB& aabb, float maxT, float& tHit)
+{
+    // slab test
+    float tEnter = 0.f;
+    float tExit = maxT;
+    for (int i = 0; i < 3; ++i) {
+        if (ray.dir[i] == 0.f) {
+            // parallel to the slab: 1/dir would give 0 * inf = NaN for origins on its planes
+            if (ray.origin[i] < aabb.min[i] || ray.origin[i] > aabb.max[i]) {
+                return false;
+            }
+            continue;
+        }
+        const auto invDir = 1.f / ray.dir[i];
+        auto t0 = (aabb.min[i] - ray.origin[i]) * invDir;
+        auto t1 = (aabb.max[i] - ray.origin[i]) * invDir;
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        tEnter = std::max(tEnter, t0);
+        tExit = std::min(tExit, t1);
+        if (tEnter > tExit) {
+            return false;
+        }
+    }
+    tHit = tEnter;
+    return true;
+}
+
+AABB transformAABB(const AABB& aabb, const glm::mat4& m)
+{
+    // see "Transforming Axis-Aligned Bounding Boxes" by Jim Arvo
+    AABB res;
+    res.min = glm::vec3{m[3]};
+    res.max = res.min;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            const auto a = m[j][i] * aabb.min[j];
+            const auto b = m[j][i] * aabb.max[j];
+            res.min[i] += std::min(a, b);
+            res.max[i] += std::max(a, b);
+        }
+    }
+    return res;
+}
+
+} // namespace util
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+struct AABB {
+    glm::vec3 min{};
+    glm::vec3 max{};
+};
+
+struct Ray {
+    glm::vec3 origin{};
+    glm::vec3 dir{0.f, 0.f, 1.f}; // normalized
+};
+
+namespace util
+{
+bool overlaps(const AABB& a, const AABB& b);
+
+// squared distance from the point to the closest point of the box (0 if inside)
+float distanceSquared(const AABB& aabb, const glm::vec3& point);
+
+// returns true if the ray hits the box at t in [0, maxT], t is written to tHit
+bool intersect(const Ray& ray, const AABB& aabb, float maxT, float& tHit);
+
+// AABB of the box transformed by the matrix
+AABB transformAABB(const AABB& aabb, const glm::mat4& m);
+}
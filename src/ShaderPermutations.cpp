@@ -0,0 +1,245 @@
+#include "ShaderPermutations.h"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <SDL2/SDL.h>
+#include <glad/gl.h>
+
+namespace
+{
+// GL_KHR_parallel_shader_compile - not included into our glad build
+constexpr GLenum GL_COMPLETION_STATUS_KHR = 0x91B1;
+typedef void(GLAD_API_PTR* PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+constexpr std::size_t MAX_FEATURES = sizeof(ShaderPermutations::Key) * 8;
+
+bool hasParallelCompile{false};
+
+std::string readFileToString(const std::filesystem::path& path)
+{
+    // open file
+    std::ifstream f(path);
+    if (!f.good()) {
+        std::cerr << "Failed to open shader file from " << path << std::endl;
+        return {};
+    }
+    // read whole file into string buffer
+    std::stringstream buffer;
+    buffer << f.rdbuf();
+    return buffer.str();
+}
+
+GLuint startShaderCompilation(const std::string& source, GLenum shaderType, std::string_view label)
+{
+    GLuint shader = glCreateShader(shaderType);
+    glObjectLabel(GL_SHADER, shader, label.size(), label.data());
+    const char* sourceCStr = source.c_str();
+    glShaderSource(shader, 1, &sourceCStr, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+void printShaderLog(GLuint shader)
+{
+    int success{};
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (success) {
+        return;
+    }
+    GLint logLength{};
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+    std::string log(logLength + 1, '\0');
+    glGetShaderInfoLog(shader, logLength, NULL, &log[0]);
+    std::cout << "Failed to compile shader:" << log << std::endl;
+}
+
+}
+
+void ShaderPermutations::initParallelCompile()
+{
+    if (!SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile")) {
+        std::cout << "GL_KHR_parallel_shader_compile is not supported, "
+                     "shader variants will be compiled one per frame\n";
+        return;
+    }
+
+    const auto maxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(
+        SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR"));
+    if (maxShaderCompilerThreads) {
+        // let the driver decide how many threads to use
+        maxShaderCompilerThreads(0xFFFFFFFF);
+    }
+    hasParallelCompile = true;
+}
+
+bool ShaderPermutations::init(
+    const std::filesystem::path& vertPath,
+    const std::filesystem::path& fragPath,
+    std::span<const std::string_view> featureDefines,
+    std::string_view label)
+{
+    assert(featureDefines.size() <= MAX_FEATURES && "too many features for the key");
+
+    vertSource = readFileToString(vertPath);
+    fragSource = readFileToString(fragPath);
+    if (vertSource.empty() || fragSource.empty()) {
+        return false;
+    }
+
+    defines.assign(featureDefines.begin(), featureDefines.end());
+    this->label = label;
+
+    request(0);
+    return true;
+}
+
+void ShaderPermutations::cleanup()
+{
+    for (auto& [key, variant] : variants) {
+        glDeleteShader(variant.vertexShader);
+        glDeleteShader(variant.fragShader);
+        glDeleteProgram(variant.program);
+    }
+    variants.clear();
+    pendingKeys.clear();
+}
+
+void ShaderPermutations::update()
+{
+    if (!hasParallelCompile) {
+        // compilation blocks without the extension, so only do one variant per frame
+        if (!pendingKeys.empty()) {
+            const auto key = pendingKeys.front();
+            pendingKeys.pop_front();
+            auto& variant = variants.at(key);
+            startCompilation(key, variant);
+            finishCompilation(key, variant);
+        }
+        return;
+    }
+
+    for (auto& [key, variant] : variants) {
+        if (variant.state == State::Compiling) {
+            finishCompilation(key, variant);
+        }
+    }
+}
+
+void ShaderPermutations::request(Key key)
+{
+    // otherwise keys which differ only in the unused bits would compile identical programs
+    assert(
+        (defines.size() == MAX_FEATURES || (key >> defines.size()) == 0) &&
+        "key has bits without corresponding features");
+    if (variants.contains(key)) {
+        return;
+    }
+
+    auto& variant = variants[key];
+    if (hasParallelCompile) {
+        startCompilation(key, variant);
+    } else {
+        pendingKeys.push_back(key);
+    }
+}
+
+void ShaderPermutations::startCompilation(Key key, Variant& variant)
+{
+    const auto programLabel = label + " #" + std::to_string(key);
+
+    variant.vertexShader = startShaderCompilation(
+        makeSource(vertSource, key), GL_VERTEX_SHADER, programLabel + " vert");
+    variant.fragShader = startShaderCompilation(
+        makeSource(fragSource, key), GL_FRAGMENT_SHADER, programLabel + " frag");
+
+    // linking right away is fine: the driver will wait for the compilation itself
+    variant.program = glCreateProgram();
+    glObjectLabel(GL_PROGRAM, variant.program, programLabel.size(), programLabel.data());
+    glAttachShader(variant.program, variant.vertexShader);
+    glAttachShader(variant.program, variant.fragShader);
+    glLinkProgram(variant.program);
+}
+
+std::uint32_t ShaderPermutations::getProgram(Key key)
+{
+    request(key);
+    if (const auto& variant = variants.at(key); variant.state == State::Ready) {
+        return variant.program;
+    }
+    if (const auto& generic = variants.at(0); generic.state == State::Ready) {
+        return generic.program;
+    }
+    return 0;
+}
+
+ShaderPermutations::State ShaderPermutations::getState(Key key) const
+{
+    const auto it = variants.find(key);
+    if (it == variants.end()) {
+        return State::Compiling;
+    }
+    return it->second.state;
+}
+
+std::string ShaderPermutations::makeSource(const std::string& source, Key key) const
+{
+    std::string definesStr;
+    for (std::size_t i = 0; i < defines.size(); ++i) {
+        if (key & (Key{1} << i)) {
+            definesStr += "#define " + defines[i] + "\n";
+        }
+    }
+
+    // #version has to be the first line of the shader
+    const auto versionPos = source.find("#version");
+    const auto lineEnd = source.find('\n', versionPos);
+    if (versionPos == std::string::npos || lineEnd == std::string::npos) {
+        return definesStr + source;
+    }
+    // keep line numbers in compile errors matching the file
+    const auto versionLine = std::count(source.begin(), source.begin() + versionPos, '\n') + 1;
+    definesStr += "#line " + std::to_string(versionLine + 1) + "\n";
+
+    auto res = source;
+    res.insert(lineEnd + 1, definesStr);
+    return res;
+}
+
+void ShaderPermutations::finishCompilation(Key key, Variant& variant)
+{
+    if (hasParallelCompile) {
+        GLint completed{};
+        glGetProgramiv(variant.program, GL_COMPLETION_STATUS_KHR, &completed);
+        if (!completed) {
+            return;
+        }
+    }
+
+    int success{};
+    glGetProgramiv(variant.program, GL_LINK_STATUS, &success);
+    if (!success) {
+        printShaderLog(variant.vertexShader);
+        printShaderLog(variant.fragShader);
+
+        GLint logLength{};
+        glGetProgramiv(variant.program, GL_INFO_LOG_LENGTH, &logLength);
+        std::string log(logLength + 1, '\0');
+        glGetProgramInfoLog(variant.program, logLength, NULL, &log[0]);
+        std::cout << "Shader linking failed (" << label << " #" << key << "): " << log
+                  << std::endl;
+        variant.state = State::Failed;
+    } else {
+        variant.state = State::Ready;
+    }
+
+    glDetachShader(variant.program, variant.vertexShader);
+    glDetachShader(variant.program, variant.fragShader);
+    glDeleteShader(variant.vertexShader);
+    glDeleteShader(variant.fragShader);
+    variant.vertexShader = 0;
+    variant.fragShader = 0;
+}
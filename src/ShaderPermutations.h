@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Compiles variants of a vertex + fragment shader pair. Each bit of the key
+// enables one feature #define which gets injected after the #version line.
+// Variants are compiled in the background with GL_KHR_parallel_shader_compile
+// if the driver supports it, otherwise update() compiles one variant per call.
+// getProgram() returns the generic variant (key 0) until the requested one
+// is ready, so it never blocks.
+class ShaderPermutations {
+public:
+    using Key = std::uint32_t;
+
+    enum class State { Compiling, Ready, Failed };
+
+    // should be called once after GL is loaded
+    static void initParallelCompile();
+
+    // starts compiling the generic variant, returns false if sources can't be read
+    bool init(
+        const std::filesystem::path& vertPath,
+        const std::filesystem::path& fragPath,
+        std::span<const std::string_view> featureDefines,
+        std::string_view label);
+    void cleanup();
+
+    // polls compiling variants, should be called once per frame
+    void update();
+
+    // starts compiling the variant if it wasn't requested before
+    void request(Key key);
+
+    // returns the variant if it's ready, the generic one if it's not,
+    // and 0 if even the generic one is still compiling
+    std::uint32_t getProgram(Key key);
+
+    State getState(Key key) const;
+
+private:
+    struct Variant {
+        std::uint32_t program{0};
+        std::uint32_t vertexShader{0};
+        std::uint32_t fragShader{0};
+        State state{State::Compiling};
+    };
+
+    std::string makeSource(const std::string& source, Key key) const;
+    void startCompilation(Key key, Variant& variant);
+    // does nothing if the variant is still compiling
+    void finishCompilation(Key key, Variant& variant);
+
+    std::string vertSource;
+    std::string fragSource;
+    std::vector<std::string> defines;
+    std::string label;
+
+    std::unordered_map<Key, Variant> variants;
+    // variants waiting to be compiled when there's no parallel compile support
+    std::deque<Key> pendingKeys;
+};
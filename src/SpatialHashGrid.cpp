@@ -0,0 +1,568 @@
+#include "SpatialHashGrid.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+
+#include <glm/common.hpp>
+#include <glm/vector_relational.hpp>
+
+namespace
+{
+constexpr std::size_t MIN_NUM_SLOTS = 64;
+
+std::size_t hashCell(const glm::ivec3& c)
+{
+    // see "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+    // by Teschner et al.
+    return static_cast<std::size_t>(
+        (static_cast<std::uint32_t>(c.x) * 73856093u) ^
+        (static_cast<std::uint32_t>(c.y) * 19349663u) ^
+        (static_cast<std::uint32_t>(c.z) * 83492791u));
+}
+
+float cellBoundary(int cell, int step, float cellSize)
+{
+    return static_cast<float>(step > 0 ? cell + 1 : cell) * cellSize;
+}
+
+}
+
+void SpatialHashGrid::init(float cellSize, std::size_t expectedNumObjects)
+{
+    assert(cellSize > 0.f);
+    this->cellSize = cellSize;
+    invCellSize = 1.f / cellSize;
+
+    slots.clear();
+    numCells = 0;
+    buckets.clear();
+    freeBucketList = NULL_INDEX;
+    objects.clear();
+    freeIds.clear();
+    numAliveObjects = 0;
+    for (auto& counts : numCellsPerCoord) {
+        counts.clear();
+    }
+    resetOccupiedBounds();
+
+    objects.reserve(expectedNumObjects);
+    buckets.reserve(expectedNumObjects);
+    // keep load factor below 0.5
+    rehash(std::max(MIN_NUM_SLOTS, std::bit_ceil(expectedNumObjects * 2)));
+}
+
+SpatialHashGrid::ObjectId SpatialHashGrid::insert(const AABB& aabb)
+{
+    ObjectId id{};
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = static_cast<ObjectId>(objects.size());
+        objects.emplace_back();
+    }
+
+    auto& object = objects[id];
+    object.aabb = aabb;
+    object.minCell = toCellCoord(aabb.min);
+    object.maxCell = toCellCoord(aabb.max);
+    object.alive = true;
+    ++numAliveObjects;
+
+    addToCells(id);
+    return id;
+}
+
+void SpatialHashGrid::update(ObjectId id, const AABB& aabb)
+{
+    auto& object = objects[id];
+    assert(object.alive);
+    object.aabb = aabb;
+
+    const auto minCell = toCellCoord(aabb.min);
+    const auto maxCell = toCellCoord(aabb.max);
+    if (minCell == object.minCell && maxCell == object.maxCell) {
+        return;
+    }
+
+    // add first, so that cells which the object doesn't leave are not freed and recreated
+    const auto oldMinCell = object.minCell;
+    const auto oldMaxCell = object.maxCell;
+    for (int x = minCell.x; x <= maxCell.x; ++x) {
+        for (int y = minCell.y; y <= maxCell.y; ++y) {
+            for (int z = minCell.z; z <= maxCell.z; ++z) {
+                const auto key = glm::ivec3{x, y, z};
+                const bool wasInCell = glm::all(glm::greaterThanEqual(key, oldMinCell)) &&
+                                       glm::all(glm::lessThanEqual(key, oldMaxCell));
+                if (!wasInCell) {
+                    addToCell(key, id);
+                }
+            }
+        }
+    }
+    for (int x = oldMinCell.x; x <= oldMaxCell.x; ++x) {
+        for (int y = oldMinCell.y; y <= oldMaxCell.y; ++y) {
+            for (int z = oldMinCell.z; z <= oldMaxCell.z; ++z) {
+                const auto key = glm::ivec3{x, y, z};
+                const bool staysInCell = glm::all(glm::greaterThanEqual(key, minCell)) &&
+                                         glm::all(glm::lessThanEqual(key, maxCell));
+                if (!staysInCell) {
+                    removeFromCell(key, id);
+                }
+            }
+        }
+    }
+
+    object.minCell = minCell;
+    object.maxCell = maxCell;
+}
+
+void SpatialHashGrid::remove(ObjectId id)
+{
+    auto& object = objects[id];
+    assert(object.alive);
+    removeFromCells(id);
+    object.alive = false;
+    --numAliveObjects;
+    freeIds.push_back(id);
+}
+
+std::optional<SpatialHashGrid::RayHit> SpatialHashGrid::raycast(
+    const Ray& ray,
+    float maxDistance) const
+{
+    if (numAliveObjects == 0) {
+        return std::nullopt;
+    }
+    const auto bounds = AABB{
+        glm::vec3{occupiedMin} * cellSize,
+        glm::vec3{occupiedMax + 1} * cellSize,
+    };
+    return raycastInBounds(ray, maxDistance, bounds);
+}
+
+void SpatialHashGrid::raycast(
+    std::span<const Ray> rays,
+    float maxDistance,
+    std::span<std::optional<RayHit>> hits) const
+{
+    assert(rays.size() == hits.size());
+    if (numAliveObjects == 0) {
+        std::fill(hits.begin(), hits.end(), std::nullopt);
+        return;
+    }
+    const auto bounds = AABB{
+        glm::vec3{occupiedMin} * cellSize,
+        glm::vec3{occupiedMax + 1} * cellSize,
+    };
+    for (std::size_t i = 0; i < rays.size(); ++i) {
+        hits[i] = raycastInBounds(rays[i], maxDistance, bounds);
+    }
+}
+
+std::optional<SpatialHashGrid::RayHit> SpatialHashGrid::raycastInBounds(
+    const Ray& ray,
+    float maxDistance,
+    const AABB& bounds) const
+{
+    // clip the ray to the occupied part of the grid so that we don't walk through empty space
+    float tStart{};
+    if (!util::intersect(ray, bounds, maxDistance, tStart)) {
+        return std::nullopt;
+    }
+
+    // 3D DDA, see "A Fast Voxel Traversal Algorithm for Ray Tracing" by Amanatides and Woo
+    auto cell =
+        glm::clamp(toCellCoord(ray.origin + ray.dir * tStart), occupiedMin, occupiedMax);
+    glm::ivec3 step{};
+    glm::vec3 tMax{std::numeric_limits<float>::infinity()};
+    glm::vec3 tDelta{std::numeric_limits<float>::infinity()};
+    for (int i = 0; i < 3; ++i) {
+        if (ray.dir[i] == 0.f) {
+            continue;
+        }
+        step[i] = ray.dir[i] > 0.f ? 1 : -1;
+        tMax[i] = (cellBoundary(cell[i], step[i], cellSize) - ray.origin[i]) / ray.dir[i];
+        tDelta[i] = cellSize / std::abs(ray.dir[i]);
+    }
+
+    std::optional<RayHit> closestHit;
+    while (true) {
+        // objects in multiple cells can be tested more than once, but that doesn't change the
+        // closest hit and is cheaper than keeping track of visited objects
+        forEachInCell(cell, [&](ObjectId id) {
+            const auto maxT = closestHit ? closestHit->distance : maxDistance;
+            float t{};
+            if (util::intersect(ray, objects[id].aabb, maxT, t)) {
+                if (!closestHit || t < closestHit->distance) {
+                    closestHit = RayHit{.object = id, .distance = t};
+                }
+            }
+        });
+
+        const int axis = (tMax.x < tMax.y) ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+        const auto tCellExit = tMax[axis];
+        // nothing in the next cells can be closer than a hit inside the current one
+        if (closestHit && closestHit->distance <= tCellExit) {
+            break;
+        }
+        if (tCellExit > maxDistance) {
+            break;
+        }
+
+        cell[axis] += step[axis];
+        if (cell[axis] < occupiedMin[axis] || cell[axis] > occupiedMax[axis]) {
+            break;
+        }
+        tMax[axis] += tDelta[axis];
+    }
+
+    return closestHit;
+}
+
+void SpatialHashGrid::queryAABB(const AABB& aabb, std::vector<ObjectId>& result) const
+{
+    if (numAliveObjects == 0) {
+        return;
+    }
+
+    const auto minCell = glm::max(toCellCoord(aabb.min), occupiedMin);
+    const auto maxCell = glm::min(toCellCoord(aabb.max), occupiedMax);
+
+    for (int x = minCell.x; x <= maxCell.x; ++x) {
+        for (int y = minCell.y; y <= maxCell.y; ++y) {
+            for (int z = minCell.z; z <= maxCell.z; ++z) {
+                const auto cell = glm::ivec3{x, y, z};
+                forEachInCell(cell, [&](ObjectId id) {
+                    const auto& object = objects[id];
+                    // report objects which span multiple cells only in the first visited one
+                    if (glm::max(object.minCell, minCell) != cell) {
+                        return;
+                    }
+                    if (util::overlaps(aabb, object.aabb)) {
+                        result.push_back(id);
+                    }
+                });
+            }
+        }
+    }
+}
+
+void SpatialHashGrid::queryKNearest(
+    const glm::vec3& point,
+    std::size_t k,
+    std::vector<ObjectId>& result) const
+{
+    if (numAliveObjects == 0 || k == 0) {
+        return;
+    }
+
+    const auto center = toCellCoord(point);
+
+    // max-heap of (squared distance, object): the top is the furthest of the k found so far
+    std::vector<std::pair<float, ObjectId>> nearest;
+    nearest.reserve(k + 1);
+
+    const auto visitCell = [&](const glm::ivec3& cell) {
+        forEachInCell(cell, [&](ObjectId id) {
+            const auto& object = objects[id];
+            // objects which span multiple cells are only checked in their cell closest
+            // to the center, which is the first one visited
+            if (glm::clamp(center, object.minCell, object.maxCell) != cell) {
+                return;
+            }
+            const auto d = util::distanceSquared(object.aabb, point);
+            if (nearest.size() == k && d >= nearest.front().first) {
+                return;
+            }
+            nearest.emplace_back(d, id);
+            std::push_heap(nearest.begin(), nearest.end());
+            if (nearest.size() > k) {
+                std::pop_heap(nearest.begin(), nearest.end());
+                nearest.pop_back();
+            }
+        });
+    };
+
+    // visit cells in rings of growing Chebyshev distance around the point's cell
+    const auto distToOccupied = glm::max(glm::max(occupiedMin - center, center - occupiedMax), 0);
+    const auto maxRing = glm::max(center - occupiedMin, occupiedMax - center);
+    const auto firstRing = std::max({distToOccupied.x, distToOccupied.y, distToOccupied.z});
+    const auto lastRing = std::max({maxRing.x, maxRing.y, maxRing.z});
+
+    for (int r = firstRing; r <= lastRing; ++r) {
+        const auto minCell = glm::max(center - r, occupiedMin);
+        const auto maxCell = glm::min(center + r, occupiedMax);
+        for (int x = minCell.x; x <= maxCell.x; ++x) {
+            for (int y = minCell.y; y <= maxCell.y; ++y) {
+                const bool onShell = std::abs(x - center.x) == r || std::abs(y - center.y) == r;
+                if (onShell) {
+                    for (int z = minCell.z; z <= maxCell.z; ++z) {
+                        visitCell(glm::ivec3{x, y, z});
+                    }
+                } else {
+                    // only the front and back faces of the ring
+                    if (center.z - r >= minCell.z) {
+                        visitCell(glm::ivec3{x, y, center.z - r});
+                    }
+                    if (center.z + r <= maxCell.z) {
+                        visitCell(glm::ivec3{x, y, center.z + r});
+                    }
+                }
+            }
+        }
+
+        // everything in the next ring is at least r cells away from the point
+        const auto nextRingDist = static_cast<float>(r) * cellSize;
+        if (nearest.size() == k && nearest.front().first <= nextRingDist * nextRingDist) {
+            break;
+        }
+    }
+
+    std::sort_heap(nearest.begin(), nearest.end());
+    for (const auto& p : nearest) {
+        result.push_back(p.second);
+    }
+}
+
+glm::ivec3 SpatialHashGrid::toCellCoord(const glm::vec3& p) const
+{
+    return glm::ivec3{glm::floor(p * invCellSize)};
+}
+
+template<typename F>
+void SpatialHashGrid::forEachInCell(const glm::ivec3& key, F&& f) const
+{
+    const auto slotIdx = findSlot(key);
+    if (slotIdx == NULL_INDEX) {
+        return;
+    }
+    for (auto b = slots[slotIdx].firstBucket; b != NULL_INDEX; b = buckets[b].next) {
+        const auto& bucket = buckets[b];
+        for (std::uint32_t i = 0; i < bucket.count; ++i) {
+            f(bucket.ids[i]);
+        }
+    }
+}
+
+std::uint32_t SpatialHashGrid::findSlot(const glm::ivec3& key) const
+{
+    const auto mask = slots.size() - 1;
+    for (auto i = hashCell(key) & mask;; i = (i + 1) & mask) {
+        const auto& slot = slots[i];
+        if (slot.firstBucket == NULL_INDEX) {
+            return NULL_INDEX;
+        }
+        if (slot.key == key) {
+            return static_cast<std::uint32_t>(i);
+        }
+    }
+}
+
+std::uint32_t SpatialHashGrid::findOrCreateSlot(const glm::ivec3& key)
+{
+    if ((numCells + 1) * 2 > slots.size()) {
+        rehash(std::max(MIN_NUM_SLOTS, slots.size() * 2));
+    }
+
+    const auto mask = slots.size() - 1;
+    for (auto i = hashCell(key) & mask;; i = (i + 1) & mask) {
+        auto& slot = slots[i];
+        if (slot.firstBucket == NULL_INDEX) {
+            const auto bucketIdx = allocateBucket();
+            slot.key = key;
+            slot.firstBucket = bucketIdx;
+            ++numCells;
+            onCellCreated(key);
+            return static_cast<std::uint32_t>(i);
+        }
+        if (slot.key == key) {
+            return static_cast<std::uint32_t>(i);
+        }
+    }
+}
+
+void SpatialHashGrid::eraseSlot(std::uint32_t slotIdx)
+{
+    // backward shift deletion: move the following entries of the probe sequence
+    // back so that lookups don't stop at the hole (no tombstones needed)
+    const auto mask = slots.size() - 1;
+    auto hole = static_cast<std::size_t>(slotIdx);
+    for (auto i = (hole + 1) & mask; slots[i].firstBucket != NULL_INDEX; i = (i + 1) & mask) {
+        const auto home = hashCell(slots[i].key) & mask;
+        // the entry can be moved into the hole only if its home slot isn't in (hole, i]
+        const bool homeInRange = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+        if (homeInRange) {
+            continue;
+        }
+        slots[hole] = slots[i];
+        hole = i;
+    }
+    slots[hole] = Slot{};
+    --numCells;
+}
+
+void SpatialHashGrid::rehash(std::size_t newNumSlots)
+{
+    assert(std::has_single_bit(newNumSlots));
+    std::vector<Slot> newSlots(newNumSlots);
+    const auto mask = newNumSlots - 1;
+    for (const auto& slot : slots) {
+        if (slot.firstBucket == NULL_INDEX) {
+            continue;
+        }
+        auto i = hashCell(slot.key) & mask;
+        while (newSlots[i].firstBucket != NULL_INDEX) {
+            i = (i + 1) & mask;
+        }
+        newSlots[i] = slot;
+    }
+    slots = std::move(newSlots);
+}
+
+std::uint32_t SpatialHashGrid::allocateBucket()
+{
+    std::uint32_t bucketIdx{};
+    if (freeBucketList != NULL_INDEX) {
+        bucketIdx = freeBucketList;
+        freeBucketList = buckets[bucketIdx].next;
+    } else {
+        bucketIdx = static_cast<std::uint32_t>(buckets.size());
+        buckets.emplace_back();
+    }
+    buckets[bucketIdx] = Bucket{};
+    return bucketIdx;
+}
+
+void SpatialHashGrid::freeBucket(std::uint32_t bucketIdx)
+{
+    buckets[bucketIdx].next = freeBucketList;
+    freeBucketList = bucketIdx;
+}
+
+void SpatialHashGrid::addToCells(ObjectId id)
+{
+    const auto& object = objects[id];
+    for (int x = object.minCell.x; x <= object.maxCell.x; ++x) {
+        for (int y = object.minCell.y; y <= object.maxCell.y; ++y) {
+            for (int z = object.minCell.z; z <= object.maxCell.z; ++z) {
+                addToCell(glm::ivec3{x, y, z}, id);
+            }
+        }
+    }
+}
+
+void SpatialHashGrid::removeFromCells(ObjectId id)
+{
+    const auto& object = objects[id];
+    for (int x = object.minCell.x; x <= object.maxCell.x; ++x) {
+        for (int y = object.minCell.y; y <= object.maxCell.y; ++y) {
+            for (int z = object.minCell.z; z <= object.maxCell.z; ++z) {
+                removeFromCell(glm::ivec3{x, y, z}, id);
+            }
+        }
+    }
+}
+
+void SpatialHashGrid::addToCell(const glm::ivec3& key, ObjectId id)
+{
+    const auto slotIdx = findOrCreateSlot(key);
+    auto headIdx = slots[slotIdx].firstBucket;
+    if (buckets[headIdx].count == BUCKET_SIZE) {
+        const auto newHeadIdx = allocateBucket();
+        buckets[newHeadIdx].next = headIdx;
+        slots[slotIdx].firstBucket = newHeadIdx;
+        headIdx = newHeadIdx;
+    }
+    auto& head = buckets[headIdx];
+    head.ids[head.count] = id;
+    ++head.count;
+}
+
+void SpatialHashGrid::removeFromCell(const glm::ivec3& key, ObjectId id)
+{
+    const auto slotIdx = findSlot(key);
+    assert(slotIdx != NULL_INDEX);
+
+    const auto headIdx = slots[slotIdx].firstBucket;
+    auto& head = buckets[headIdx];
+    for (auto b = headIdx; b != NULL_INDEX; b = buckets[b].next) {
+        auto& bucket = buckets[b];
+        const auto end = bucket.ids.begin() + bucket.count;
+        const auto it = std::find(bucket.ids.begin(), end, id);
+        if (it == end) {
+            continue;
+        }
+
+        // fill the hole with the last id of the first bucket, so that only it can be partial
+        *it = head.ids[head.count - 1];
+        --head.count;
+        if (head.count == 0) {
+            slots[slotIdx].firstBucket = head.next;
+            freeBucket(headIdx);
+            if (slots[slotIdx].firstBucket == NULL_INDEX) {
+                // the slot is already marked as empty, but the probe sequence must be fixed
+                eraseSlot(slotIdx);
+                onCellErased(key);
+            }
+        }
+        return;
+    }
+    assert(false && "object is not in the cell");
+}
+
+void SpatialHashGrid::onCellCreated(const glm::ivec3& key)
+{
+    for (int i = 0; i < 3; ++i) {
+        auto& counts = numCellsPerCoord[i];
+        const auto c = key[i];
+        if (counts.empty()) {
+            coordsBase[i] = c;
+            counts.resize(1);
+        } else if (c < coordsBase[i]) {
+            // grow at least twice so that the cost is amortized
+            const auto grow = std::max<std::size_t>(coordsBase[i] - c, counts.size());
+            counts.insert(counts.begin(), grow, 0);
+            coordsBase[i] -= static_cast<int>(grow);
+        } else if (static_cast<std::size_t>(c - coordsBase[i]) >= counts.size()) {
+            counts.resize(std::max<std::size_t>(c - coordsBase[i] + 1, counts.size() * 2));
+        }
+        ++counts[c - coordsBase[i]];
+        occupiedMin[i] = std::min(occupiedMin[i], c);
+        occupiedMax[i] = std::max(occupiedMax[i], c);
+    }
+}
+
+void SpatialHashGrid::onCellErased(const glm::ivec3& key)
+{
+    for (int i = 0; i < 3; ++i) {
+        auto& count = numCellsPerCoord[i][key[i] - coordsBase[i]];
+        assert(count > 0);
+        --count;
+    }
+
+    if (numCells == 0) {
+        resetOccupiedBounds();
+        return;
+    }
+
+    // shrink the bounds if the last cell on the boundary was erased,
+    // there's at least one non-empty coord on each axis, so the loops stop
+    for (int i = 0; i < 3; ++i) {
+        const auto& counts = numCellsPerCoord[i];
+        while (counts[occupiedMin[i] - coordsBase[i]] == 0) {
+            ++occupiedMin[i];
+        }
+        while (counts[occupiedMax[i] - coordsBase[i]] == 0) {
+            --occupiedMax[i];
+        }
+    }
+}
+
+void SpatialHashGrid::resetOccupiedBounds()
+{
+    occupiedMin = glm::ivec3{std::numeric_limits<int>::max()};
+    occupiedMax = glm::ivec3{std::numeric_limits<int>::min()};
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "Geometry.h"
+
+// Uniform grid for spatial queries. Only non-empty cells are stored: they
+// live in an open addressing hash table keyed by cell coords and are freed
+// as soon as the last object leaves them. Objects are registered in every
+// cell their AABB touches, so the cell size should be roughly the size of
+// a typical object.
+//
+// Queries don't modify the grid, so they can run concurrently from multiple
+// threads as long as nothing inserts, updates or removes objects meanwhile.
+class SpatialHashGrid {
+public:
+    using ObjectId = std::uint32_t;
+    static constexpr ObjectId NULL_OBJECT = std::numeric_limits<ObjectId>::max();
+
+    struct RayHit {
+        ObjectId object{NULL_OBJECT};
+        float distance{0.f};
+    };
+
+    void init(float cellSize, std::size_t expectedNumObjects = 0);
+
+    ObjectId insert(const AABB& aabb);
+    // cheap if the object didn't move to other cells
+    void update(ObjectId id, const AABB& aabb);
+    void remove(ObjectId id);
+
+    const AABB& getAABB(ObjectId id) const { return objects[id].aabb; }
+    std::size_t getNumObjects() const { return numAliveObjects; }
+    std::size_t getNumCells() const { return numCells; }
+
+    std::optional<RayHit> raycast(const Ray& ray, float maxDistance) const;
+    // hits.size() must be equal to rays.size(),
+    // large batches can be split into chunks and processed on different threads
+    void raycast(
+        std::span<const Ray> rays,
+        float maxDistance,
+        std::span<std::optional<RayHit>> hits) const;
+
+    // appends all objects which AABB overlaps the given one
+    void queryAABB(const AABB& aabb, std::vector<ObjectId>& result) const;
+
+    // appends up to k objects closest to the point, sorted by distance
+    void queryKNearest(const glm::vec3& point, std::size_t k, std::vector<ObjectId>& result)
+        const;
+
+private:
+    static constexpr std::uint32_t NULL_INDEX = std::numeric_limits<std::uint32_t>::max();
+    static constexpr std::size_t BUCKET_SIZE = 6;
+
+    // empty if firstBucket == NULL_INDEX
+    struct Slot {
+        glm::ivec3 key;
+        std::uint32_t firstBucket{NULL_INDEX};
+    };
+
+    // object ids of a cell are stored in a list of fixed size buckets,
+    // only the first bucket of the list can be partially filled
+    struct Bucket {
+        std::array<ObjectId, BUCKET_SIZE> ids;
+        std::uint32_t count{0};
+        std::uint32_t next{NULL_INDEX};
+    };
+
+    struct Object {
+        AABB aabb;
+        glm::ivec3 minCell;
+        glm::ivec3 maxCell;
+        bool alive{false};
+    };
+
+    glm::ivec3 toCellCoord(const glm::vec3& p) const;
+
+    std::optional<RayHit> raycastInBounds(const Ray& ray, float maxDistance, const AABB& bounds)
+        const;
+    template<typename F>
+    void forEachInCell(const glm::ivec3& key, F&& f) const;
+
+    std::uint32_t findSlot(const glm::ivec3& key) const;
+    // creates the cell with one empty bucket if it doesn't exist
+    std::uint32_t findOrCreateSlot(const glm::ivec3& key);
+    void eraseSlot(std::uint32_t slotIdx);
+    void rehash(std::size_t newNumSlots);
+
+    std::uint32_t allocateBucket();
+    void freeBucket(std::uint32_t bucketIdx);
+
+    void addToCells(ObjectId id);
+    void removeFromCells(ObjectId id);
+    void addToCell(const glm::ivec3& key, ObjectId id);
+    void removeFromCell(const glm::ivec3& key, ObjectId id);
+
+    void onCellCreated(const glm::ivec3& key);
+    void onCellErased(const glm::ivec3& key);
+    void resetOccupiedBounds();
+
+    float cellSize{1.f};
+    float invCellSize{1.f};
+
+    std::vector<Slot> slots; // size is always a power of two
+    std::size_t numCells{0};
+
+    std::vector<Bucket> buckets;
+    std::uint32_t freeBucketList{NULL_INDEX}; // linked through Bucket::next
+
+    std::vector<Object> objects;
+    std::vector<ObjectId> freeIds;
+    std::size_t numAliveObjects{0};
+
+    // number of non-empty cells for each coord on each axis (indexed by coord - coordsBase),
+    // used to keep exact bounds of the occupied cells which are used to clip queries.
+    // The arrays only grow, so moving objects inside the covered range doesn't allocate
+    std::array<std::vector<std::uint32_t>, 3> numCellsPerCoord;
+    glm::ivec3 coordsBase{};
+    glm::ivec3 occupiedMin{std::numeric_limits<int>::max()};
+    glm::ivec3 occupiedMax{std::numeric_limits<int>::min()};
+};
@@ -0,0 +1,271 @@
+// Compares SpatialHashGrid queries against linear scans over all objects
+// and checks that both return the same results.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "Camera.h"
+#include "Geometry.h"
+#include "SpatialHashGrid.h"
+
+namespace
+{
+constexpr auto CELL_SIZE = 1.f;
+constexpr auto OBJECTS_PER_UNIT_VOLUME = 0.25f;
+constexpr auto MIN_OBJECT_SIZE = 0.1f;
+constexpr auto MAX_OBJECT_SIZE = 0.5f;
+
+constexpr auto RAYS_PER_SIDE = 16; // rays are cast through a RAYS_PER_SIDE^2 pixel grid
+constexpr auto NUM_AABB_QUERIES = 256;
+constexpr auto NUM_KNN_QUERIES = 256;
+constexpr auto KNN_K = 8;
+constexpr auto MOVED_OBJECTS_FRACTION = 0.1f;
+
+using ObjectId = SpatialHashGrid::ObjectId;
+using RayHit = SpatialHashGrid::RayHit;
+
+template<typename F>
+double measureMs(F&& f)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    f();
+    const auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+AABB makeBox(const glm::vec3& center, float size)
+{
+    return AABB{center - glm::vec3{size / 2.f}, center + glm::vec3{size / 2.f}};
+}
+
+std::optional<RayHit> bruteForceRaycast(
+    const std::vector<AABB>& boxes,
+    const Ray& ray,
+    float maxDistance)
+{
+    std::optional<RayHit> closestHit;
+    for (std::size_t i = 0; i < boxes.size(); ++i) {
+        const auto maxT = closestHit ? closestHit->distance : maxDistance;
+        float t{};
+        if (util::intersect(ray, boxes[i], maxT, t) && (!closestHit || t < closestHit->distance)) {
+            closestHit = RayHit{.object = static_cast<ObjectId>(i), .distance = t};
+        }
+    }
+    return closestHit;
+}
+
+void bruteForceAABB(const std::vector<AABB>& boxes, const AABB& aabb, std::vector<ObjectId>& res)
+{
+    for (std::size_t i = 0; i < boxes.size(); ++i) {
+        if (util::overlaps(aabb, boxes[i])) {
+            res.push_back(static_cast<ObjectId>(i));
+        }
+    }
+}
+
+void bruteForceKNearest(
+    const std::vector<AABB>& boxes,
+    const glm::vec3& point,
+    std::size_t k,
+    std::vector<ObjectId>& res)
+{
+    std::vector<std::pair<float, ObjectId>> dists(boxes.size());
+    for (std::size_t i = 0; i < boxes.size(); ++i) {
+        dists[i] = {util::distanceSquared(boxes[i], point), static_cast<ObjectId>(i)};
+    }
+    k = std::min(k, dists.size());
+    std::partial_sort(dists.begin(), dists.begin() + k, dists.end());
+    for (std::size_t i = 0; i < k; ++i) {
+        res.push_back(dists[i].second);
+    }
+}
+
+bool sameHit(const std::optional<RayHit>& a, const std::optional<RayHit>& b)
+{
+    if (a.has_value() != b.has_value()) {
+        return false;
+    }
+    // different objects can be hit at the same distance, so only compare distances
+    return !a || std::abs(a->distance - b->distance) <= 1e-4f * std::max(1.f, a->distance);
+}
+
+// returns false if the results don't match
+bool runBenchmark(std::size_t numObjects, std::mt19937& rng)
+{
+    const auto worldSize =
+        std::cbrt(static_cast<float>(numObjects) / OBJECTS_PER_UNIT_VOLUME);
+    std::uniform_real_distribution<float> posDist(0.f, worldSize);
+    std::uniform_real_distribution<float> sizeDist(MIN_OBJECT_SIZE, MAX_OBJECT_SIZE);
+
+    std::vector<AABB> boxes(numObjects);
+    for (auto& box : boxes) {
+        box = makeBox(glm::vec3{posDist(rng), posDist(rng), posDist(rng)}, sizeDist(rng));
+    }
+
+    std::cout << numObjects << " objects, world size " << std::setprecision(1) << worldSize
+              << std::setprecision(2) << "\n";
+
+    SpatialHashGrid grid;
+    const auto buildMs = measureMs([&]() {
+        grid.init(CELL_SIZE, numObjects);
+        for (const auto& box : boxes) {
+            grid.insert(box);
+        }
+    });
+    std::cout << "  build:   " << std::setw(10) << buildMs << " ms, " << grid.getNumCells()
+              << " cells\n";
+
+    { // incremental update - move some objects by a small random offset
+        std::uniform_real_distribution<float> offsetDist(-CELL_SIZE, CELL_SIZE);
+        std::uniform_int_distribution<std::size_t> idDist(0, numObjects - 1);
+        const auto numMoved = static_cast<std::size_t>(numObjects * MOVED_OBJECTS_FRACTION);
+        std::vector<ObjectId> moved(numMoved);
+        for (auto& id : moved) {
+            id = static_cast<ObjectId>(idDist(rng));
+            const auto offset = glm::vec3{offsetDist(rng), offsetDist(rng), offsetDist(rng)};
+            boxes[id].min += offset;
+            boxes[id].max += offset;
+        }
+        const auto updateMs = measureMs([&]() {
+            for (const auto id : moved) {
+                grid.update(id, boxes[id]);
+            }
+        });
+        std::cout << "  update:  " << std::setw(10) << updateMs << " ms (" << numMoved
+                  << " objects), " << grid.getNumCells() << " cells\n";
+    }
+
+    bool ok = true;
+
+    { // rays from the camera through the screen pixels
+        Camera camera;
+        camera.init(glm::radians(90.f), 0.1f, 1000.f, 1.f);
+        camera.setPosition(glm::vec3{worldSize / 2.f, worldSize / 2.f, -worldSize * 0.25f});
+        camera.lookAt(glm::vec3{worldSize / 2.f});
+
+        const auto screenSize = glm::vec2{static_cast<float>(RAYS_PER_SIDE)};
+        std::vector<Ray> rays;
+        for (int y = 0; y < RAYS_PER_SIDE; ++y) {
+            for (int x = 0; x < RAYS_PER_SIDE; ++x) {
+                const auto pixel = glm::vec2{static_cast<float>(x), static_cast<float>(y)} + 0.5f;
+                rays.push_back(camera.getRayThroughPixel(pixel, screenSize));
+            }
+        }
+
+        const auto maxDistance = worldSize * 3.f;
+        std::vector<std::optional<RayHit>> gridHits(rays.size());
+        std::vector<std::optional<RayHit>> bruteHits(rays.size());
+        const auto gridMs = measureMs([&]() { grid.raycast(rays, maxDistance, gridHits); });
+        const auto bruteMs = measureMs([&]() {
+            for (std::size_t i = 0; i < rays.size(); ++i) {
+                bruteHits[i] = bruteForceRaycast(boxes, rays[i], maxDistance);
+            }
+        });
+
+        std::size_t numHits = 0;
+        for (std::size_t i = 0; i < rays.size(); ++i) {
+            if (!sameHit(gridHits[i], bruteHits[i])) {
+                std::cout << "  raycast mismatch for ray " << i << "\n";
+                ok = false;
+            }
+            numHits += gridHits[i].has_value();
+        }
+        std::cout << "  raycast: " << std::setw(10) << gridMs << " ms, brute force "
+                  << std::setw(10) << bruteMs << " ms (" << rays.size() << " rays, " << numHits
+                  << " hits)\n";
+    }
+
+    { // AABB overlap
+        std::uniform_real_distribution<float> querySizeDist(2.f, 6.f);
+        std::vector<AABB> queries(NUM_AABB_QUERIES);
+        for (auto& q : queries) {
+            q = makeBox(glm::vec3{posDist(rng), posDist(rng), posDist(rng)}, querySizeDist(rng));
+        }
+
+        std::vector<std::vector<ObjectId>> gridRes(queries.size());
+        std::vector<std::vector<ObjectId>> bruteRes(queries.size());
+        const auto gridMs = measureMs([&]() {
+            for (std::size_t i = 0; i < queries.size(); ++i) {
+                grid.queryAABB(queries[i], gridRes[i]);
+            }
+        });
+        const auto bruteMs = measureMs([&]() {
+            for (std::size_t i = 0; i < queries.size(); ++i) {
+                bruteForceAABB(boxes, queries[i], bruteRes[i]);
+            }
+        });
+
+        for (std::size_t i = 0; i < queries.size(); ++i) {
+            std::sort(gridRes[i].begin(), gridRes[i].end());
+            if (gridRes[i] != bruteRes[i]) {
+                std::cout << "  AABB query mismatch for query " << i << "\n";
+                ok = false;
+            }
+        }
+        std::cout << "  AABB:    " << std::setw(10) << gridMs << " ms, brute force "
+                  << std::setw(10) << bruteMs << " ms (" << queries.size() << " queries)\n";
+    }
+
+    { // k nearest
+        std::vector<glm::vec3> points(NUM_KNN_QUERIES);
+        for (auto& p : points) {
+            p = glm::vec3{posDist(rng), posDist(rng), posDist(rng)};
+        }
+
+        std::vector<std::vector<ObjectId>> gridRes(points.size());
+        std::vector<std::vector<ObjectId>> bruteRes(points.size());
+        const auto gridMs = measureMs([&]() {
+            for (std::size_t i = 0; i < points.size(); ++i) {
+                grid.queryKNearest(points[i], KNN_K, gridRes[i]);
+            }
+        });
+        const auto bruteMs = measureMs([&]() {
+            for (std::size_t i = 0; i < points.size(); ++i) {
+                bruteForceKNearest(boxes, points[i], KNN_K, bruteRes[i]);
+            }
+        });
+
+        // different objects can be at the same distance, so compare distances
+        const auto toDistances = [&](const std::vector<ObjectId>& ids, const glm::vec3& p) {
+            std::vector<float> dists;
+            for (const auto id : ids) {
+                dists.push_back(util::distanceSquared(boxes[id], p));
+            }
+            return dists;
+        };
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            if (toDistances(gridRes[i], points[i]) != toDistances(bruteRes[i], points[i])) {
+                std::cout << "  k nearest mismatch for query " << i << "\n";
+                ok = false;
+            }
+        }
+        std::cout << "  k=" << KNN_K << ":     " << std::setw(10) << gridMs << " ms, brute force "
+                  << std::setw(10) << bruteMs << " ms (" << points.size() << " queries)\n";
+    }
+
+    return ok;
+}
+
+}
+
+int main()
+{
+    std::mt19937 rng(42);
+    std::cout << std::fixed << std::setprecision(2);
+
+    bool ok = true;
+    for (const std::size_t numObjects : {10'000, 100'000, 1'000'000}) {
+        ok = runBenchmark(numObjects, rng) && ok;
+    }
+
+    if (!ok) {
+        std::cout << "Results of the grid and brute force don't match\n";
+        return 1;
+    }
+}